@@ -0,0 +1,122 @@
+// Encoded size and decode throughput of CompactFormat integer sequence encodings
+// on time-series shaped data.
+//
+// Usage: compact_bench [values]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sequential.h"
+#include "../formats/compact_format.h"
+
+namespace
+{
+    template<typename Encoding>
+    struct Series
+    {
+        ATTRIBUTE_ENCODED(std::vector<std::int64_t>, values, Encoding)
+        INIT_ATTRIBUTES(values)
+    };
+
+    // Millisecond timestamps sampled once a second with a little jitter
+    std::vector<std::int64_t> timestamps(std::size_t count, std::mt19937_64 &random)
+    {
+        std::vector<std::int64_t> values(count);
+        std::int64_t now = 1700000000000;
+        for (auto &value: values)
+        {
+            now += 1000 + static_cast<std::int64_t>(random() % 16) - 8;
+            value = now;
+        }
+        return values;
+    }
+
+    // Mostly increasing ids, as handed out by a sequence shared between writers
+    std::vector<std::int64_t> ids(std::size_t count, std::mt19937_64 &random)
+    {
+        std::vector<std::int64_t> values(count);
+        std::int64_t next = 5000000;
+        for (auto &value: values)
+        {
+            next += 1 + static_cast<std::int64_t>(random() % 4);
+            value = (random() % 16 == 0) ? next - static_cast<std::int64_t>(random() % 64) : next;
+        }
+        return values;
+    }
+
+    // Monotonic byte counter with bursty increments and occasional resets
+    std::vector<std::int64_t> counters(std::size_t count, std::mt19937_64 &random)
+    {
+        std::vector<std::int64_t> values(count);
+        std::int64_t total = 0;
+        for (auto &value: values)
+        {
+            total += (random() % 8 == 0) ? static_cast<std::int64_t>(random() % 1000000) : static_cast<std::int64_t>(random() % 1500);
+            if (random() % 100000 == 0)
+                total = 0;
+            value = total;
+        }
+        return values;
+    }
+
+    template<typename Encoding>
+    void measure(const char *series, const char *encoding, const std::vector<std::int64_t> &values)
+    {
+        Series<Encoding> record;
+        record.set_values(values);
+
+        CompactFormat encoder;
+        sequential::to_format(encoder, record);
+        const std::string encoded = encoder.output();
+
+        const int rounds = 20;
+        double best = 0;
+        for (int round = 0; round < rounds; ++round)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            Series<Encoding> decoded;
+            sequential::from_format(CompactFormat(encoded), decoded);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (decoded.get_values() != values)
+            {
+                std::fprintf(stderr, "%s/%s: round trip mismatch\n", series, encoding);
+                std::exit(1);
+            }
+
+            const double rate = values.size() / elapsed.count() / 1e6;
+            if (rate > best)
+                best = rate;
+        }
+
+        std::printf("%-10s %-22s %12zu bytes %7.2f bytes/value %9.1f Mvalues/s\n",
+                    series, encoding, encoded.size(), double(encoded.size()) / values.size(), best);
+    }
+
+    void measureAll(const char *series, const std::vector<std::int64_t> &values)
+    {
+        std::printf("%-10s %-22s %12zu bytes %7.2f bytes/value\n",
+                    series, "raw int64", values.size() * sizeof(std::int64_t), double(sizeof(std::int64_t)));
+        measure<sequential::encoding::plain>(series, "plain", values);
+        measure<sequential::encoding::delta_varint>(series, "delta_varint", values);
+        measure<sequential::encoding::frame_of_reference<128>>(series, "frame_of_reference<128>", values);
+        measure<sequential::encoding::frame_of_reference<1024>>(series, "frame_of_reference<1024>", values);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::mt19937_64 random(2026);
+
+    measureAll("timestamps", timestamps(count, random));
+    measureAll("ids", ids(count, random));
+    measureAll("counters", counters(count, random));
+
+    return 0;
+}
@@ -0,0 +1,612 @@
+#ifndef COMPACT_FORMAT_H
+#define COMPACT_FORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <type_traits>
+#include <stdexcept>
+
+#include "../sequential.h"
+
+class CompactFormat
+{
+public:
+    typedef std::vector<std::string> ArrayType;
+
+private:
+    enum Kind : std::uint8_t
+    {
+        Record = 0,
+        List = 1
+    };
+
+    enum Tag : std::uint8_t
+    {
+        Integer = 0,
+        Real = 1,
+        Bytes = 2,
+        IntegerSequence = 3,
+        DeltaSequence = 4,
+        FrameOfReferenceSequence = 5,
+        RealSequence = 6,
+        BytesSequence = 7
+    };
+
+    struct Entry
+    {
+        std::size_t keyOffset;
+        std::size_t keyLength;
+        Tag tag;
+        std::size_t offset;
+    };
+
+public:
+    CompactFormat() : data_(1, char(Record)), entries_() {}
+    CompactFormat(const std::string &data) : data_(data), entries_() { index(); }
+    CompactFormat(std::string &&data) : data_(std::move(data)), entries_() { index(); }
+
+public:
+    template<typename ValueType,
+        typename std::enable_if<std::is_arithmetic<ValueType>::value>::type * = nullptr>
+    void write(const std::pair<const char *, ValueType> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        if (std::is_floating_point<ValueType>::value)
+        {
+            writeKey(attribute.first, Real);
+            writeReal(static_cast<double>(attribute.second));
+        }
+        else
+        {
+            writeKey(attribute.first, Integer);
+            writeVarint(zigzag(static_cast<std::int64_t>(attribute.second)));
+        }
+    }
+
+    void write(const std::pair<const char *, std::string> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, Bytes);
+        writeBytes(attribute.second.data(), attribute.second.size());
+    }
+
+    void write(const std::pair<const char *, const char *> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, Bytes);
+        writeBytes(attribute.second, std::strlen(attribute.second));
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_integral<ValueType>::value>::type * = nullptr>
+    void write(const std::pair<const char *, std::vector<ValueType>> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, IntegerSequence);
+        writeVarint(attribute.second.size());
+        for (const auto value: attribute.second)
+            writeVarint(zigzag(static_cast<std::int64_t>(value)));
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_floating_point<ValueType>::value>::type * = nullptr>
+    void write(const std::pair<const char *, std::vector<ValueType>> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, RealSequence);
+        writeVarint(attribute.second.size());
+        for (const auto value: attribute.second)
+            writeReal(static_cast<double>(value));
+    }
+
+    void write(const std::pair<const char *, std::vector<std::string>> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, BytesSequence);
+        writeVarint(attribute.second.size());
+        for (const auto &value: attribute.second)
+            writeBytes(value.data(), value.size());
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_integral<ValueType>::value>::type * = nullptr>
+    void write(const std::pair<const char *, std::vector<ValueType>> &attribute,
+               const sequential::encoding::delta_varint *)
+    {
+        writeKey(attribute.first, DeltaSequence);
+        writeVarint(attribute.second.size());
+
+        std::uint64_t previous = 0;
+        for (const auto value: attribute.second)
+        {
+            const auto current = static_cast<std::uint64_t>(value);
+            writeVarint(zigzag(static_cast<std::int64_t>(current - previous)));
+            previous = current;
+        }
+    }
+
+    template<typename ValueType, std::size_t BlockSize,
+        typename std::enable_if<std::is_integral<ValueType>::value>::type * = nullptr>
+    void write(const std::pair<const char *, std::vector<ValueType>> &attribute,
+               const sequential::encoding::frame_of_reference<BlockSize> *)
+    {
+        const auto &values = attribute.second;
+
+        writeKey(attribute.first, FrameOfReferenceSequence);
+        writeVarint(values.size());
+        writeVarint(BlockSize);
+
+        std::vector<std::int64_t> deltas(values.size());
+        std::uint64_t previous = 0;
+        for (std::size_t it = 0; it < values.size(); ++it)
+        {
+            const auto current = static_cast<std::uint64_t>(values[it]);
+            deltas[it] = static_cast<std::int64_t>(current - previous);
+            previous = current;
+        }
+
+        for (std::size_t begin = 0; begin < deltas.size(); begin += BlockSize)
+        {
+            const std::size_t end = std::min(begin + BlockSize, deltas.size());
+
+            std::int64_t reference = deltas[begin];
+            for (std::size_t it = begin + 1; it < end; ++it)
+                reference = std::min(reference, deltas[it]);
+
+            std::uint64_t spread = 0;
+            for (std::size_t it = begin; it < end; ++it)
+                spread |= static_cast<std::uint64_t>(deltas[it]) - static_cast<std::uint64_t>(reference);
+
+            std::uint8_t width = 0;
+            while (width < 64 && (spread >> width) != 0)
+                ++width;
+
+            writeVarint(zigzag(reference));
+            data_.push_back(static_cast<char>(width));
+
+            std::uint64_t buffer = 0;
+            std::uint8_t buffered = 0;
+            for (std::size_t it = begin; it < end && width > 0; ++it)
+            {
+                const std::uint64_t offset = static_cast<std::uint64_t>(deltas[it]) - static_cast<std::uint64_t>(reference);
+                std::uint8_t remaining = width;
+                while (remaining > 0)
+                {
+                    const std::uint8_t take = std::min<std::uint8_t>(remaining, 64 - buffered);
+                    const std::uint64_t chunk = (offset >> (width - remaining)) & mask(take);
+                    buffer |= chunk << buffered;
+                    buffered += take;
+                    remaining -= take;
+                    if (buffered == 64)
+                    {
+                        writeWord(buffer, 8);
+                        buffer = 0;
+                        buffered = 0;
+                    }
+                }
+            }
+            if (buffered > 0)
+                writeWord(buffer, (buffered + 7) / 8);
+        }
+    }
+
+    void write(const std::pair<const char *, bool> &attribute,
+               const sequential::encoding::plain * = nullptr)
+    {
+        writeKey(attribute.first, Integer);
+        writeVarint(attribute.second ? 1 : 0);
+    }
+
+    template<typename ValueType>
+    const ValueType get(const char *key, const ValueType * = nullptr) const
+    {
+        ValueType value = ValueType();
+
+        const Entry *entry = find(key);
+        if (entry != nullptr)
+        {
+            std::size_t position = entry->offset;
+            read(*entry, position, value);
+        }
+
+        return value;
+    }
+
+    std::size_t length() const
+    {
+        std::size_t length = 0;
+        if (!data_.empty() && data_[0] == char(List))
+            length = entries_.size();
+
+        return length;
+    }
+
+    CompactFormat at(std::size_t index) const
+    {
+        std::size_t position = entries_.at(index).offset;
+        const std::size_t size = readVarint(position);
+        return CompactFormat(data_.substr(position, size));
+    }
+
+    inline std::string output() const
+    {
+        return data_;
+    }
+
+    inline void clear()
+    {
+        data_.assign(1, char(Record));
+        entries_.clear();
+    }
+
+private:
+    void index()
+    {
+        entries_.clear();
+        if (data_.empty())
+        {
+            data_.assign(1, char(Record));
+            return;
+        }
+
+        std::size_t position = 1;
+        if (data_[0] == char(List))
+        {
+            const std::size_t count = readVarint(position);
+            entries_.reserve(count);
+            for (std::size_t it = 0; it < count; ++it)
+            {
+                entries_.push_back({ 0, 0, Bytes, position });
+                const std::size_t size = readVarint(position);
+                position += size;
+            }
+            return;
+        }
+
+        while (position < data_.size())
+        {
+            Entry entry;
+            entry.keyLength = readVarint(position);
+            entry.keyOffset = position;
+            position += entry.keyLength;
+            entry.tag = static_cast<Tag>(data_.at(position++));
+            entry.offset = position;
+            entries_.push_back(entry);
+            skip(entry.tag, position);
+        }
+    }
+
+    void skip(Tag tag, std::size_t &position) const
+    {
+        switch (tag)
+        {
+        case Integer:
+            readVarint(position);
+            break;
+        case Real:
+            position += sizeof(double);
+            break;
+        case Bytes:
+            position += readVarint(position);
+            break;
+        case IntegerSequence:
+        case DeltaSequence:
+            for (std::size_t count = readVarint(position); count > 0; --count)
+                readVarint(position);
+            break;
+        case RealSequence:
+            position += readVarint(position) * sizeof(double);
+            break;
+        case BytesSequence:
+            for (std::size_t count = readVarint(position); count > 0; --count)
+                position += readVarint(position);
+            break;
+        case FrameOfReferenceSequence:
+        {
+            const std::size_t count = readVarint(position);
+            const std::size_t blockSize = readVarint(position);
+            for (std::size_t begin = 0; begin < count; begin += blockSize)
+            {
+                const std::size_t size = std::min(blockSize, count - begin);
+                readVarint(position);
+                const std::uint8_t width = static_cast<std::uint8_t>(data_.at(position++));
+                position += (size * width + 7) / 8;
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("CompactFormat: unknown value tag");
+        }
+
+        if (position > data_.size())
+            throw std::runtime_error("CompactFormat: truncated input");
+    }
+
+    const Entry *find(const char *key) const
+    {
+        const std::size_t keyLength = std::strlen(key);
+        for (const auto &entry: entries_)
+        {
+            if (entry.keyLength == keyLength &&
+                data_.compare(entry.keyOffset, keyLength, key, keyLength) == 0)
+                return &entry;
+        }
+
+        return nullptr;
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_arithmetic<ValueType>::value>::type * = nullptr>
+    void read(const Entry &entry, std::size_t &position, ValueType &value) const
+    {
+        if (entry.tag == Real)
+            value = static_cast<ValueType>(readReal(position));
+        else if (entry.tag == Integer)
+            value = static_cast<ValueType>(unzigzag(readVarint(position)));
+    }
+
+    void read(const Entry &entry, std::size_t &position, std::string &value) const
+    {
+        if (entry.tag == BytesSequence)
+        {
+            const std::size_t begin = position;
+            skip(entry.tag, position);
+            value.assign(1, char(List));
+            value.append(data_, begin, position - begin);
+            return;
+        }
+
+        if (entry.tag != Bytes)
+            return;
+
+        const std::size_t size = readVarint(position);
+        value.assign(data_, position, size);
+        position += size;
+    }
+
+    void read(const Entry &entry, std::size_t &position, std::vector<std::string> &value) const
+    {
+        if (entry.tag != BytesSequence)
+            return;
+
+        const std::size_t count = readVarint(position);
+        value.reserve(count);
+        for (std::size_t it = 0; it < count; ++it)
+        {
+            const std::size_t size = readVarint(position);
+            value.emplace_back(data_, position, size);
+            position += size;
+        }
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_floating_point<ValueType>::value>::type * = nullptr>
+    void read(const Entry &entry, std::size_t &position, std::vector<ValueType> &value) const
+    {
+        if (entry.tag != RealSequence)
+            return;
+
+        const std::size_t count = readVarint(position);
+        value.resize(count);
+        for (std::size_t it = 0; it < count; ++it)
+            value[it] = static_cast<ValueType>(readReal(position));
+    }
+
+    template<typename ValueType,
+        typename std::enable_if<std::is_integral<ValueType>::value>::type * = nullptr>
+    void read(const Entry &entry, std::size_t &position, std::vector<ValueType> &value) const
+    {
+        switch (entry.tag)
+        {
+        case IntegerSequence:
+        {
+            const std::size_t count = readVarint(position);
+            value.resize(count);
+            for (std::size_t it = 0; it < count; ++it)
+                value[it] = static_cast<ValueType>(unzigzag(readVarint(position)));
+            break;
+        }
+        case DeltaSequence:
+        {
+            const std::size_t count = readVarint(position);
+            value.resize(count);
+
+            const auto *bytes = reinterpret_cast<const std::uint8_t *>(data_.data());
+            const std::size_t end = data_.size();
+            std::uint64_t current = 0;
+            for (std::size_t it = 0; it < count; ++it)
+            {
+                std::uint64_t encoded;
+                if (position < end && bytes[position] < 0x80)
+                    encoded = bytes[position++];
+                else
+                    encoded = readVarint(position);
+                current += static_cast<std::uint64_t>(unzigzag(encoded));
+                value[it] = static_cast<ValueType>(current);
+            }
+            break;
+        }
+        case FrameOfReferenceSequence:
+        {
+            const std::size_t count = readVarint(position);
+            const std::size_t blockSize = readVarint(position);
+            value.resize(count);
+
+            std::uint64_t current = 0;
+            for (std::size_t begin = 0; begin < count; begin += blockSize)
+            {
+                const std::size_t end = begin + std::min(blockSize, count - begin);
+                const std::uint64_t reference = static_cast<std::uint64_t>(unzigzag(readVarint(position)));
+                const std::uint8_t width = static_cast<std::uint8_t>(data_.at(position++));
+
+                if (width == 0)
+                {
+                    for (std::size_t it = begin; it < end; ++it)
+                    {
+                        current += reference;
+                        value[it] = static_cast<ValueType>(current);
+                    }
+                    continue;
+                }
+
+                const std::size_t packedSize = ((end - begin) * width + 7) / 8;
+                if (position + packedSize > data_.size())
+                    throw std::runtime_error("CompactFormat: truncated input");
+
+                const auto *packed = reinterpret_cast<const std::uint8_t *>(data_.data()) + position;
+                const std::size_t available = data_.size() - position;
+                const std::uint64_t valueMask = mask(width);
+                std::size_t bit = 0;
+                for (std::size_t it = begin; it < end; ++it, bit += width)
+                {
+                    const std::size_t byte = bit / 8;
+                    const unsigned shift = bit % 8;
+
+                    std::uint64_t offset;
+                    if (byte + sizeof(std::uint64_t) < available)
+                    {
+                        offset = loadWord(packed + byte) >> shift;
+                        if (shift + width > 64)
+                            offset |= static_cast<std::uint64_t>(packed[byte + sizeof(std::uint64_t)]) << (64 - shift);
+                    }
+                    else
+                    {
+                        offset = 0;
+                        for (std::size_t tail = 0; byte + tail < available && tail <= sizeof(std::uint64_t); ++tail)
+                        {
+                            const std::uint64_t chunk = packed[byte + tail];
+                            if (tail == 0)
+                                offset = chunk >> shift;
+                            else if (tail * 8 - shift < 64)
+                                offset |= chunk << (tail * 8 - shift);
+                        }
+                    }
+
+                    current += reference + (offset & valueMask);
+                    value[it] = static_cast<ValueType>(current);
+                }
+                position += packedSize;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void writeKey(const char *key, Tag tag)
+    {
+        const std::size_t keyLength = std::strlen(key);
+        writeVarint(keyLength);
+        data_.append(key, keyLength);
+        data_.push_back(static_cast<char>(tag));
+    }
+
+    void writeVarint(std::uint64_t value)
+    {
+        appendVarint(data_, value);
+    }
+
+    void writeReal(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writeWord(bits, sizeof(bits));
+    }
+
+    void writeBytes(const char *bytes, std::size_t size)
+    {
+        writeVarint(size);
+        data_.append(bytes, size);
+    }
+
+    void writeWord(std::uint64_t word, std::size_t bytes)
+    {
+        for (std::size_t it = 0; it < bytes; ++it)
+            data_.push_back(static_cast<char>((word >> (it * 8)) & 0xFF));
+    }
+
+    std::uint64_t readVarint(std::size_t &position) const
+    {
+        std::uint64_t value = 0;
+        for (std::uint8_t shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= data_.size())
+                throw std::runtime_error("CompactFormat: truncated input");
+
+            const std::uint8_t byte = static_cast<std::uint8_t>(data_[position++]);
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+
+        throw std::runtime_error("CompactFormat: malformed varint");
+    }
+
+    double readReal(std::size_t &position) const
+    {
+        if (position + sizeof(double) > data_.size())
+            throw std::runtime_error("CompactFormat: truncated input");
+
+        std::uint64_t bits = 0;
+        for (std::size_t it = 0; it < sizeof(bits); ++it)
+            bits |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data_[position + it])) << (it * 8);
+        position += sizeof(bits);
+
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static std::uint64_t loadWord(const std::uint8_t *bytes)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        return word;
+    }
+
+    static void appendVarint(std::string &data, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<char>(value));
+    }
+
+    static constexpr std::uint64_t zigzag(std::int64_t value)
+    {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    static constexpr std::int64_t unzigzag(std::uint64_t value)
+    {
+        return static_cast<std::int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    static constexpr std::uint64_t mask(std::uint8_t bits)
+    {
+        return bits >= 64 ? std::numeric_limits<std::uint64_t>::max() : (std::uint64_t(1) << bits) - 1;
+    }
+
+private:
+    std::string data_;
+    std::vector<Entry> entries_;
+};
+
+template<>
+struct sequential::framing::default_for<CompactFormat>
+{
+    typedef sequential::framing::length_prefixed type;
+};
+
+#endif // COMPACT_FORMAT_H
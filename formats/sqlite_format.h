@@ -5,18 +5,50 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 #include <sqlite3.h>
 
 #include <fmt/format.h>
 
+#include "../sequential.h"
+
 class SQLiteFormat
 {
+public:
+    struct Schema
+    {
+        std::vector<std::pair<std::string, const char *>> columns;
+        std::string definitions;
+        std::string columnList;
+        std::string placeholders;
+    };
+
+private:
+    enum class Affinity { Integer, Text, Blob, Real, Numeric };
+
+    struct Value
+    {
+        enum Type { Integer, Real, Text, Blob };
+
+        const char *column;
+        const char *affinity;
+        Type type;
+        sqlite3_int64 integer;
+        double real;
+        std::string text;
+    };
+
 public:
     SQLiteFormat(const std::string &path, std::string &&table) :
         dbHandle_(nullptr),
         table_(table),
-        columns_(),
-        query_(),
+        row_(),
+        rowSchema_(),
+        statements_(),
+        failures_(),
         error_(nullptr)
     {
         sqlite3_open(path.c_str(), &dbHandle_);
@@ -24,86 +56,78 @@ public:
 
     ~SQLiteFormat()
     {
+        for (auto &statement: statements_)
+            sqlite3_finalize(statement.second);
+
         if (dbHandle_)
             sqlite3_close(dbHandle_);
     }
 
 public:
-    void write(const std::pair<const char *, int> &attribute)
+    template<typename Struct>
+    static const Schema &schema()
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} INTEGER", attribute.first));
+        static const Schema schema = [] {
+            std::vector<std::pair<std::string, const char *>> columns;
+            sequential::static_for_each<Struct>([&columns](auto attribute) {
+                typedef typename std::remove_pointer<decltype(attribute)>::type Attribute;
+                columns.emplace_back(Attribute::string(),
+                                     affinity(static_cast<const typename Attribute::value_type *>(nullptr)));
+            });
+            return makeSchema(std::move(columns));
+        }();
+
+        return schema;
+    }
 
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("{}", attribute.second));
+    void write(const std::pair<const char *, int> &attribute)
+    {
+        Value value = { attribute.first, affinity(&attribute.second), Value::Integer, attribute.second, 0.0, {} };
+        row_.push_back(std::move(value));
     }
 
     void write(const std::pair<const char *, double> &attribute)
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} REAL", attribute.first));
-
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("{}", attribute.second));
+        Value value = { attribute.first, affinity(&attribute.second), Value::Real, 0, attribute.second, {} };
+        row_.push_back(std::move(value));
     }
 
     void write(const std::pair<const char *, std::string> &attribute)
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} TEXT", attribute.first));
-
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("'{}'", attribute.second));
+        Value value = { attribute.first, affinity(&attribute.second), Value::Text, 0, 0.0, attribute.second };
+        row_.push_back(std::move(value));
     }
 
     void write(const std::pair<const char *, const char *> &attribute)
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} TEXT", attribute.first));
-
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("'{}'", attribute.second));
+        Value value = { attribute.first, affinity(&attribute.second), Value::Text, 0, 0.0, attribute.second };
+        row_.push_back(std::move(value));
     }
 
     void write(const std::pair<const char *, const unsigned char *> &attribute)
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} GLOB", attribute.first));
-
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("'{}'", attribute.second));
+        Value value = { attribute.first, affinity(&attribute.second), Value::Blob, 0, 0.0,
+                        reinterpret_cast<const char *>(attribute.second) };
+        row_.push_back(std::move(value));
     }
 
     void write(const std::pair<const char *, bool> &attribute)
     {
-        if (!columns_.empty())
-            columns_.append(", ");
-        columns_.append(fmt::format("{} INTEGER", attribute.first));
-
-        if (!query_.empty())
-            query_.append(", ");
-        query_.append(fmt::format("{}", attribute.second ? 1 : 0));
+        Value value = { attribute.first, affinity(&attribute.second), Value::Integer, attribute.second ? 1 : 0, 0.0, {} };
+        row_.push_back(std::move(value));
     }
 
     template<typename ValueType>
     const ValueType get(const char *key, const ValueType * = nullptr) const
     {
-        ValueType value;
+        ValueType value = ValueType();
 
         if (!tableData_.empty())
         {
-            auto column = *(tableData_.begin());
-            value = type_cast(column.at(key), static_cast<ValueType *>(nullptr));
+            const auto &column = *(tableData_.begin());
+            const auto cell = column.find(key);
+            if (cell != column.end())
+                value = type_cast(cell->second, static_cast<ValueType *>(nullptr));
         }
 
         return value;
@@ -123,59 +147,274 @@ public:
     }
 
     void flush(std::string *error = nullptr)
+    {
+        if (rowSchema_.columns.empty() || !matches(rowSchema_))
+        {
+            auto cached = statements_.find(&rowSchema_);
+            if (cached != statements_.end())
+            {
+                sqlite3_finalize(cached->second);
+                statements_.erase(cached);
+                failures_.erase(&rowSchema_);
+            }
+
+            std::vector<std::pair<std::string, const char *>> columns;
+            for (const auto &value: row_)
+                columns.emplace_back(value.column, value.affinity);
+            rowSchema_ = makeSchema(std::move(columns));
+        }
+
+        insert(rowSchema_, error);
+    }
+
+    template<typename Struct>
+    void flush(std::string *error = nullptr)
+    {
+        insert(schema<Struct>(), error);
+    }
+
+    std::size_t rowCount() const
+    {
+        return tableData_.size();
+    }
+
+    void removeFormatedRow()
+    {
+        tableData_.erase(tableData_.begin());
+    }
+
+    void removeRow(const std::string &columnName, const std::string &columnValue, std::string *error = nullptr)
     {
         if (error_ != nullptr)
             sqlite3_free(error_);
 
         if (sqlite3_exec(dbHandle_,
-                         fmt::format("CREATE TABLE IF NOT EXISTS {} ({});", table_, columns_).c_str(),
+                         fmt::format("DELETE FROM {} WHERE {}='{}';", table_, columnName, columnValue).c_str(),
                          nullptr, nullptr, &error_) != SQLITE_OK)
         {
             if (error)
                 *error = error_;
             sqlite3_free(error_);
             error_ = nullptr;
-            return;
         }
+    }
 
-        if (sqlite3_exec(dbHandle_,
-                         fmt::format("INSERT INTO {} VALUES({});", table_, query_).c_str(),
-                         nullptr, nullptr, &error_) != SQLITE_OK)
+private:
+    static Schema makeSchema(std::vector<std::pair<std::string, const char *>> &&columns)
+    {
+        Schema schema;
+        schema.columns = std::move(columns);
+
+        for (const auto &column: schema.columns)
+        {
+            if (!schema.columnList.empty())
+            {
+                schema.definitions.append(", ");
+                schema.columnList.append(", ");
+                schema.placeholders.append(", ");
+            }
+            schema.definitions.append(fmt::format("{} {}", column.first, column.second));
+            schema.columnList.append(column.first);
+            schema.placeholders.append("?");
+        }
+
+        return schema;
+    }
+
+    void insert(const Schema &schema, std::string *error)
+    {
+        if (!matches(schema))
         {
             if (error)
-                *error = error_;
-            sqlite3_free(error_);
-            error_ = nullptr;
+                *error = fmt::format("row does not match the columns ({}) of table {}",
+                                     schema.columnList, table_);
+            row_.clear();
+            return;
+        }
+
+        sqlite3_stmt *statement = prepare(schema, error);
+        if (statement != nullptr)
+        {
+            for (std::size_t it = 0; it < row_.size(); ++it)
+            {
+                const auto &value = row_[it];
+                const int index = static_cast<int>(it + 1);
+                switch (value.type)
+                {
+                case Value::Integer:
+                    sqlite3_bind_int64(statement, index, value.integer);
+                    break;
+                case Value::Real:
+                    sqlite3_bind_double(statement, index, value.real);
+                    break;
+                case Value::Text:
+                    sqlite3_bind_text(statement, index, value.text.data(),
+                                      static_cast<int>(value.text.size()), SQLITE_STATIC);
+                    break;
+                case Value::Blob:
+                    sqlite3_bind_blob(statement, index, value.text.data(),
+                                      static_cast<int>(value.text.size()), SQLITE_STATIC);
+                    break;
+                }
+            }
+
+            if (sqlite3_step(statement) != SQLITE_DONE && error)
+                *error = sqlite3_errmsg(dbHandle_);
+
+            sqlite3_reset(statement);
+            sqlite3_clear_bindings(statement);
         }
+
+        row_.clear();
     }
 
-    std::size_t rowCount() const
+    bool matches(const Schema &schema) const
     {
-        return tableData_.size();
+        if (row_.size() != schema.columns.size())
+            return false;
+
+        for (std::size_t it = 0; it < row_.size(); ++it)
+        {
+            if (schema.columns[it].first != row_[it].column)
+                return false;
+        }
+
+        return true;
     }
 
-    void removeFormatedRow()
+    sqlite3_stmt *prepare(const Schema &schema, std::string *error)
     {
-        tableData_.erase(tableData_.begin());
+        // A schema is checked against the live table once per connection; a failed
+        // check is remembered as a null statement so it is not retried for every row
+        auto cached = statements_.find(&schema);
+        if (cached != statements_.end())
+        {
+            if (cached->second == nullptr && error)
+                *error = failures_[&schema];
+            return cached->second;
+        }
+
+        std::string failure;
+        sqlite3_stmt *statement = nullptr;
+        if (migrate(schema, &failure) &&
+            sqlite3_prepare_v2(dbHandle_,
+                               fmt::format("INSERT INTO {} ({}) VALUES({});",
+                                           table_, schema.columnList, schema.placeholders).c_str(),
+                               -1, &statement, nullptr) != SQLITE_OK)
+        {
+            failure = sqlite3_errmsg(dbHandle_);
+            sqlite3_finalize(statement);
+            statement = nullptr;
+        }
+
+        if (statement == nullptr)
+        {
+            failures_[&schema] = failure;
+            if (error)
+                *error = failure;
+        }
+
+        statements_[&schema] = statement;
+        return statement;
     }
 
-    void removeRow(const std::string &columnName, const std::string &columnValue, std::string *error = nullptr)
+    bool migrate(const Schema &schema, std::string *error)
+    {
+        if (!execute(fmt::format("CREATE TABLE IF NOT EXISTS {} ({});", table_, schema.definitions), error))
+            return false;
+
+        std::map<std::string, std::string> existing;
+        sqlite3_stmt *statement = nullptr;
+        if (sqlite3_prepare_v2(dbHandle_, fmt::format("PRAGMA table_info({});", table_).c_str(),
+                               -1, &statement, nullptr) != SQLITE_OK)
+        {
+            if (error)
+                *error = sqlite3_errmsg(dbHandle_);
+            sqlite3_finalize(statement);
+            return false;
+        }
+
+        while (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            const auto declared = sqlite3_column_text(statement, 2);
+            existing[reinterpret_cast<const char *>(sqlite3_column_text(statement, 1))] =
+                declared != nullptr ? reinterpret_cast<const char *>(declared) : "";
+        }
+        sqlite3_finalize(statement);
+
+        for (const auto &column: schema.columns)
+        {
+            const auto live = existing.find(column.first);
+            if (live == existing.end())
+            {
+                if (!execute(fmt::format("ALTER TABLE {} ADD COLUMN {} {};", table_, column.first, column.second), error))
+                    return false;
+            }
+            else if (!compatible(affinityOf(live->second), affinityOf(column.second)))
+            {
+                if (error)
+                    *error = fmt::format("column {} of table {} is declared {}, expected {}",
+                                         column.first, table_, live->second, column.second);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool execute(const std::string &query, std::string *error)
     {
         if (error_ != nullptr)
             sqlite3_free(error_);
 
-        if (sqlite3_exec(dbHandle_,
-                         fmt::format("DELETE FROM {} WHERE {}='{}';", table_, columnName, columnValue).c_str(),
-                         nullptr, nullptr, &error_) != SQLITE_OK)
+        if (sqlite3_exec(dbHandle_, query.c_str(), nullptr, nullptr, &error_) != SQLITE_OK)
         {
             if (error)
                 *error = error_;
             sqlite3_free(error_);
             error_ = nullptr;
+            return false;
         }
+
+        return true;
     }
 
-private:
+    // Column affinity of a declared type, following SQLite's rules (datatype3.html, 3.1)
+    static Affinity affinityOf(const std::string &declared)
+    {
+        std::string type(declared);
+        std::transform(type.begin(), type.end(), type.begin(), [](unsigned char c) { return std::toupper(c); });
+
+        if (type.find("INT") != std::string::npos)
+            return Affinity::Integer;
+        if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos ||
+            type.find("TEXT") != std::string::npos)
+            return Affinity::Text;
+        if (type.empty() || type.find("BLOB") != std::string::npos)
+            return Affinity::Blob;
+        if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos ||
+            type.find("DOUB") != std::string::npos)
+            return Affinity::Real;
+        return Affinity::Numeric;
+    }
+
+    // Only text going into a numeric column, or numbers going into a text column, come back
+    // mis-typed; byte attributes are declared GLOB (NUMERIC) and are stored as they are
+    static bool compatible(Affinity live, Affinity expected)
+    {
+        if (live == expected || live == Affinity::Blob || expected == Affinity::Numeric)
+            return true;
+
+        return (live == Affinity::Text) == (expected == Affinity::Text);
+    }
+
+    static constexpr const char *affinity(const int *) { return "INTEGER"; }
+    static constexpr const char *affinity(const double *) { return "REAL"; }
+    static constexpr const char *affinity(const std::string *) { return "TEXT"; }
+    static constexpr const char *affinity(const char * const *) { return "TEXT"; }
+    static constexpr const char *affinity(const unsigned char * const *) { return "GLOB"; }
+    static constexpr const char *affinity(const bool *) { return "INTEGER"; }
+
     static int selectCallback(void *sqliteFormat, int columnCount, char **value, char **columnName)
     {
         SQLiteFormat *self = static_cast<SQLiteFormat *>(sqliteFormat);
@@ -183,7 +422,8 @@ private:
 
         for (int it = 0; it < columnCount; ++it)
         {
-            column[columnName[it]] = value[it];
+            if (value[it] != nullptr)
+                column[columnName[it]] = value[it];
         }
 
         self->tableData_.push_back(std::move(column));
@@ -224,8 +464,10 @@ private:
 private:
     sqlite3 *dbHandle_;
     const std::string table_;
-    std::string columns_;
-    std::string query_;
+    std::vector<Value> row_;
+    Schema rowSchema_;
+    std::map<const Schema *, sqlite3_stmt *> statements_;
+    std::map<const Schema *, std::string> failures_;
     char *error_;
     std::list<std::map<std::string, std::string>> tableData_;
 };
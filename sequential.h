@@ -5,16 +5,24 @@
 #include <vector>
 #include <tuple>
 #include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 
 #include <iostream>
 
 #include "sequential_p.h"
 
-#define ATTRIBUTE(type, name)                                    \
+#define ATTRIBUTE(value_type, name)                              \
+    ATTRIBUTE_ENCODED(value_type, name,                          \
+        typename ::sequential::encoding::default_for<value_type>::type)
+
+#define ATTRIBUTE_ENCODED(type, name, encoding_type)             \
     private:                                                     \
     struct name                                                  \
     {                                                            \
         typedef type value_type;                                 \
+        typedef encoding_type encoding;                          \
         name() : name##_() {}                                    \
         name(const type &value) : name##_(value) {}              \
         name(type &&value) : name##_(std::move(value)) {}        \
@@ -59,6 +67,137 @@
 
 struct sequential
 {
+    struct encoding
+    {
+        // Values are handed to the format as they are
+        struct plain {};
+
+        // Integer sequences are stored as zig-zag deltas packed in LEB128 varints
+        struct delta_varint {};
+
+        // Integer sequences are stored as deltas bit-packed in blocks of BlockSize,
+        // relative to the smallest delta of each block
+        template<std::size_t BlockSize = 128>
+        struct frame_of_reference
+        {
+            static_assert(BlockSize > 0, "frame_of_reference needs a non-empty block size");
+            static constexpr std::size_t block_size = BlockSize;
+        };
+
+        // Specialize to change the encoding of every ATTRIBUTE of a given type
+        template<typename ValueType>
+        struct default_for
+        {
+            typedef plain type;
+        };
+    };
+
+    struct framing
+    {
+        // One record per line, as in NDJSON; blank lines are skipped
+        struct newline_delimited
+        {
+            // Bytes of buffer before scanned are known to hold no newline, so input
+            // that trickles in for a long record is searched only once
+            static bool next(const std::string &buffer, std::size_t &position, std::size_t &scanned,
+                             std::size_t &offset, std::size_t &size)
+            {
+                for (;;)
+                {
+                    const auto end = buffer.find('\n', std::max(position, scanned));
+                    if (end == std::string::npos)
+                    {
+                        scanned = buffer.size();
+                        return false;
+                    }
+
+                    scanned = end + 1;
+                    offset = position;
+                    size = end - position;
+                    position = end + 1;
+                    if (size > 0 && buffer[offset + size - 1] == '\r')
+                        --size;
+                    if (size > 0)
+                        return true;
+                }
+            }
+
+            static void append(std::string &out, const std::string &record)
+            {
+                out.append(record);
+                out.push_back('\n');
+            }
+
+            static bool last(const std::string &buffer, std::size_t &position,
+                             std::size_t &offset, std::size_t &size)
+            {
+                offset = position;
+                size = buffer.size() - position;
+                position = buffer.size();
+                if (size > 0 && buffer[offset + size - 1] == '\r')
+                    --size;
+                return size > 0;
+            }
+        };
+
+        // Every record is preceded by its size as an LEB128 varint
+        struct length_prefixed
+        {
+            static bool next(const std::string &buffer, std::size_t &position, std::size_t &,
+                             std::size_t &offset, std::size_t &size)
+            {
+                std::size_t cursor = position;
+                std::uint64_t length = 0;
+                for (unsigned shift = 0;; shift += 7)
+                {
+                    if (cursor >= buffer.size())
+                        return false;
+                    if (shift >= 64)
+                        throw std::runtime_error("sequential: malformed record length");
+
+                    const auto byte = static_cast<unsigned char>(buffer[cursor++]);
+                    length |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0)
+                        break;
+                }
+
+                if (buffer.size() - cursor < length)
+                    return false;
+
+                offset = cursor;
+                size = static_cast<std::size_t>(length);
+                position = cursor + size;
+                return true;
+            }
+
+            static void append(std::string &out, const std::string &record)
+            {
+                std::uint64_t length = record.size();
+                while (length >= 0x80)
+                {
+                    out.push_back(static_cast<char>((length & 0x7F) | 0x80));
+                    length >>= 7;
+                }
+                out.push_back(static_cast<char>(length));
+                out.append(record);
+            }
+
+            static bool last(const std::string &buffer, std::size_t &position, std::size_t &, std::size_t &)
+            {
+                if (position < buffer.size())
+                    throw std::runtime_error("sequential: truncated record at end of stream");
+                return false;
+            }
+        };
+
+        // Specialize to change the framing decode_stream uses for a given Format
+        template<typename Format>
+        struct default_for
+        {
+            typedef newline_delimited type;
+        };
+    };
+
     template<typename Struct, typename Functor>
     inline static void for_each(const Struct &instance, Functor &&f)
     {
@@ -71,6 +210,13 @@ struct sequential
         sequential_private::for_each<std::tuple_size<typename Struct::Attributes>::value - 1>(instance.attributes, f);
     }
 
+    template<typename Struct, typename Functor>
+    inline static void static_for_each(Functor &&f)
+    {
+        typedef typename Struct::Attributes Attributes;
+        sequential_private::static_for_each<std::tuple_size<Attributes>::value - 1, Attributes>(f);
+    }
+
     struct attribute
     {
         template<typename Attribute>
@@ -119,6 +265,36 @@ struct sequential
         >
         static void to_format(Format &&format, const Attribute &attribute)
         {
+            write_value(format, attribute);
+        }
+
+        template<typename Format, typename Attribute,
+            typename std::enable_if<
+                sequential_private::has_encoded_write<Format, typename Attribute::value_type, typename Attribute::encoding>::value
+            >::type * = nullptr
+        >
+        static void write_value(Format &format, const Attribute &attribute)
+        {
+            static_assert(std::is_same<typename Attribute::encoding, encoding::plain>::value ||
+                          sequential_private::is_integral_sequence<typename Attribute::value_type>::value,
+                          "non-plain encodings only apply to std::vector of an integral type");
+            format.write(std::make_pair(attribute.string(), attribute.value()),
+                         static_cast<const typename Attribute::encoding *>(nullptr));
+        }
+
+        template<typename Format, typename Attribute,
+            typename std::enable_if<
+                !sequential_private::has_encoded_write<Format, typename Attribute::value_type, typename Attribute::encoding>::value
+            >::type * = nullptr
+        >
+        static void write_value(Format &format, const Attribute &attribute)
+        {
+            // Formats that know nothing about encodings get the plain value; the rest must honour the policy
+            static_assert(std::is_same<typename Attribute::encoding, encoding::plain>::value ||
+                          (sequential_private::is_integral_sequence<typename Attribute::value_type>::value &&
+                           !sequential_private::has_encoded_write<Format, typename Attribute::value_type, encoding::plain>::value),
+                          "non-plain encodings only apply to std::vector of an integral type, "
+                          "and only to formats that implement the encoding");
             format.write(std::make_pair(attribute.string(), attribute.value()));
         }
 
@@ -232,6 +408,48 @@ struct sequential
             attribute::from_format(format, attribute);
         });
     }
+
+#ifdef SEQUENTIAL_HAS_COROUTINES
+    // Source is called for more input whenever the buffered data holds no complete
+    // record; it returns the next chunk, or an empty string at the end of the stream.
+    template<typename Struct, typename Format,
+             typename Framing = typename framing::default_for<Format>::type, typename Source>
+    static sequential_private::generator<Struct> decode_stream(Source source)
+    {
+        std::string buffer;
+        std::size_t position = 0;
+        std::size_t scanned = 0;
+        std::size_t offset = 0;
+        std::size_t size = 0;
+
+        for (bool done = false; !done;)
+        {
+            while (Framing::next(buffer, position, scanned, offset, size))
+            {
+                Struct instance;
+                from_format(Format(buffer.substr(offset, size)), instance);
+                co_yield instance;
+            }
+
+            buffer.erase(0, position);
+            scanned = scanned > position ? scanned - position : 0;
+            position = 0;
+
+            std::string chunk = source();
+            if (chunk.empty())
+                done = true;
+            else
+                buffer.append(chunk);
+        }
+
+        if (Framing::last(buffer, position, offset, size))
+        {
+            Struct instance;
+            from_format(Format(buffer.substr(offset, size)), instance);
+            co_yield instance;
+        }
+    }
+#endif
 };
 
 #endif // SEQUENTIAL_H
@@ -7,6 +7,14 @@
 #include <deque>
 #include <forward_list>
 #include <list>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define SEQUENTIAL_HAS_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#endif
 
 namespace sequential_private
 {
@@ -69,6 +77,113 @@ namespace sequential_private
         static constexpr bool value = decltype(test<Attribute>(0))::value;
     };
 
+    template<typename Format, typename ValueType, typename Encoding>
+    class has_encoded_write
+    {
+        template<typename F> static std::true_type test(decltype(std::declval<F &>().write(
+            std::declval<const std::pair<const char *, ValueType> &>(),
+            static_cast<const Encoding *>(nullptr))) *);
+        template<typename F> static std::false_type test(...);
+    public:
+        static constexpr bool value = decltype(test<Format>(0))::value;
+    };
+
+#ifdef SEQUENTIAL_HAS_COROUTINES
+    template<typename ValueType>
+    class generator
+    {
+    public:
+        struct promise_type
+        {
+            ValueType *value = nullptr;
+            std::exception_ptr exception;
+
+            generator get_return_object()
+            {
+                return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+
+            std::suspend_always yield_value(ValueType &v) noexcept
+            {
+                value = &v;
+                return {};
+            }
+
+            void return_void() {}
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        class iterator
+        {
+        public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef std::ptrdiff_t difference_type;
+            typedef ValueType value_type;
+            typedef ValueType &reference;
+            typedef ValueType *pointer;
+
+            iterator() : handle_(nullptr) {}
+            explicit iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) { advance(); }
+
+            reference operator*() const { return *handle_.promise().value; }
+            pointer operator->() const { return handle_.promise().value; }
+            iterator &operator++() { advance(); return *this; }
+            void operator++(int) { advance(); }
+
+            bool operator==(std::default_sentinel_t) const { return !handle_ || handle_.done(); }
+
+        private:
+            void advance()
+            {
+                if (!handle_)
+                    return;
+
+                handle_.resume();
+                if (handle_.done() && handle_.promise().exception)
+                    std::rethrow_exception(handle_.promise().exception);
+            }
+
+        private:
+            std::coroutine_handle<promise_type> handle_;
+        };
+
+    public:
+        generator(generator &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+        generator(const generator &) = delete;
+        generator &operator=(const generator &) = delete;
+
+        ~generator()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        iterator begin() { return handle_ ? iterator(handle_) : iterator(); }
+        std::default_sentinel_t end() { return {}; }
+
+    private:
+        explicit generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+#endif
+
+    template<typename ValueType>
+    struct is_integral_sequence
+    {
+        static constexpr bool value = false;
+    };
+
+    template<typename ValueType>
+    struct is_integral_sequence<std::vector<ValueType>>
+    {
+        static constexpr bool value = std::is_integral<ValueType>::value && !std::is_same<ValueType, bool>::value;
+    };
+
     template<typename ContainerType>
     struct is_variable_size_container
     {
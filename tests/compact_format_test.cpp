@@ -0,0 +1,145 @@
+// Round-trip checks for CompactFormat and its integer sequence encodings.
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sequential.h"
+#include "../formats/compact_format.h"
+
+#include "test.h"
+
+namespace
+{
+    template<typename Record>
+    Record roundTrip(const Record &record)
+    {
+        CompactFormat format;
+        sequential::to_format(format, record);
+
+        Record decoded;
+        sequential::from_format(CompactFormat(format.output()), decoded);
+        return decoded;
+    }
+
+    struct Signed
+    {
+        ATTRIBUTE(std::vector<std::int64_t>, plain)
+        ATTRIBUTE_ENCODED(std::vector<std::int64_t>, delta, sequential::encoding::delta_varint)
+        ATTRIBUTE_ENCODED(std::vector<std::int64_t>, frame, sequential::encoding::frame_of_reference<4>)
+        INIT_ATTRIBUTES(plain, delta, frame)
+    };
+
+    struct Unsigned
+    {
+        ATTRIBUTE(std::vector<std::uint64_t>, plain)
+        ATTRIBUTE_ENCODED(std::vector<std::uint64_t>, delta, sequential::encoding::delta_varint)
+        ATTRIBUTE_ENCODED(std::vector<std::uint64_t>, frame, sequential::encoding::frame_of_reference<4>)
+        INIT_ATTRIBUTES(plain, delta, frame)
+    };
+
+    struct Narrow
+    {
+        ATTRIBUTE_ENCODED(std::vector<std::int32_t>, delta, sequential::encoding::delta_varint)
+        ATTRIBUTE_ENCODED(std::vector<std::uint16_t>, frame, sequential::encoding::frame_of_reference<>)
+        INIT_ATTRIBUTES(delta, frame)
+    };
+
+    struct Inner
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, label)
+        INIT_ATTRIBUTES(id, label)
+    };
+
+    struct Mixed
+    {
+        ATTRIBUTE(double, ratio)
+        ATTRIBUTE(bool, flag)
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE(Inner, inner)
+        ATTRIBUTE(std::vector<Inner>, inners)
+        INIT_ATTRIBUTES(ratio, flag, name, inner, inners)
+    };
+
+    template<typename Record, typename ValueType>
+    void checkSequence(const std::vector<ValueType> &values, const char *what)
+    {
+        Record record;
+        record.set_plain(values);
+        record.set_delta(values);
+        record.set_frame(values);
+
+        const Record decoded = roundTrip(record);
+        test::expect(decoded.get_plain(), values, what);
+        test::expect(decoded.get_delta(), values, what);
+        test::expect(decoded.get_frame(), values, what);
+    }
+}
+
+int main()
+{
+    const auto int64Min = std::numeric_limits<std::int64_t>::min();
+    const auto int64Max = std::numeric_limits<std::int64_t>::max();
+    const auto uint64Max = std::numeric_limits<std::uint64_t>::max();
+
+    typedef std::vector<std::int64_t> SignedValues;
+    typedef std::vector<std::uint64_t> UnsignedValues;
+
+    checkSequence<Signed>(SignedValues(), "empty signed sequence");
+    checkSequence<Unsigned>(UnsignedValues(), "empty unsigned sequence");
+    checkSequence<Signed>(SignedValues{ 42 }, "single value");
+    checkSequence<Signed>(SignedValues{ int64Min, int64Max, int64Min, 0, int64Max, -1, 1, int64Min + 1, int64Max - 1 },
+                          "signed wraparound");
+    checkSequence<Unsigned>(UnsignedValues{ 0, uint64Max, 0, uint64Max - 1, 1, uint64Max, uint64Max / 2 + 1 },
+                            "unsigned wraparound");
+    checkSequence<Signed>(SignedValues{ 7, 7, 7, 7, 7, 7, 7, 7, 7 }, "constant deltas");
+
+    std::mt19937_64 random(26);
+    std::vector<std::int64_t> timestamps;
+    std::vector<std::uint64_t> noise;
+    std::int64_t now = 1700000000000;
+    for (int it = 0; it < 10001; ++it)
+    {
+        now += 1000 + static_cast<std::int64_t>(random() % 16);
+        timestamps.push_back(now);
+        noise.push_back(random() >> (random() % 64));
+    }
+    checkSequence<Signed>(timestamps, "timestamps");
+    checkSequence<Unsigned>(noise, "random widths");
+
+    Narrow narrow;
+    narrow.set_delta({ std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::max(), 0, -5 });
+    narrow.set_frame({ 0, 65535, 1, 65534 });
+    const Narrow narrowDecoded = roundTrip(narrow);
+    test::expect(narrowDecoded.get_delta(), narrow.get_delta(), "narrow delta_varint");
+    test::expect(narrowDecoded.get_frame(), narrow.get_frame(), "narrow frame_of_reference");
+
+    Mixed mixed;
+    mixed.set_ratio(-0.125);
+    mixed.set_flag(true);
+    mixed.set_name("compact");
+    Inner inner;
+    inner.set_id(-3);
+    inner.set_label("inner");
+    mixed.set_inner(inner);
+    for (int it = 0; it < 3; ++it)
+    {
+        inner.set_id(it);
+        inner.set_label(std::string(it, 'x'));
+        mixed.get_inners().push_back(inner);
+    }
+    const Mixed mixedDecoded = roundTrip(mixed);
+    test::expect(mixedDecoded.get_ratio(), -0.125, "real");
+    test::expect(mixedDecoded.get_flag(), true, "bool");
+    test::expect(mixedDecoded.get_name(), std::string("compact"), "string");
+    test::expect(mixedDecoded.get_inner().get_id(), -3, "nested integer");
+    test::expect(mixedDecoded.get_inner().get_label(), std::string("inner"), "nested string");
+    test::expect(mixedDecoded.get_inners().size(), std::size_t(3), "nested array length");
+    test::expect(mixedDecoded.get_inners()[2].get_label(), std::string("xx"), "nested array element");
+
+    return test::finish("compact_format_test");
+}
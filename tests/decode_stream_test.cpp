@@ -0,0 +1,184 @@
+// Chunked decoding through sequential::decode_stream for both framings.
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../sequential.h"
+#include "../formats/compact_format.h"
+#if __has_include(<json.hpp>)
+#define SEQUENTIAL_TEST_JSON
+#include "../formats/json_format.h"
+#endif
+
+#include "test.h"
+
+namespace
+{
+    struct Sample
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE_ENCODED(std::vector<std::int64_t>, timestamps, sequential::encoding::delta_varint)
+        INIT_ATTRIBUTES(id, name, timestamps)
+    };
+
+    // Minimal text format, one "value" per line, to exercise newline framing
+    class LineFormat
+    {
+    public:
+        LineFormat(const std::string &text) : text_(text) {}
+
+        template<typename ValueType>
+        const ValueType get(const char *, const ValueType * = nullptr) const
+        {
+            return text_;
+        }
+
+    private:
+        std::string text_;
+    };
+
+    struct Line
+    {
+        ATTRIBUTE(std::string, text)
+        INIT_ATTRIBUTES(text)
+    };
+
+    // Hands out input chunkSize bytes at a time, as a socket or pipe would
+    struct ChunkedSource
+    {
+        const std::string *input;
+        std::size_t chunkSize;
+        std::size_t position;
+
+        std::string operator()()
+        {
+            const std::string chunk = input->substr(position, chunkSize);
+            position += chunk.size();
+            return chunk;
+        }
+    };
+
+    struct Event
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE(std::vector<std::int64_t>, timestamps)
+        INIT_ATTRIBUTES(id, name, timestamps)
+    };
+
+    std::string lengthPrefixedStream(int count)
+    {
+        std::string stream;
+        for (int it = 0; it < count; ++it)
+        {
+            Sample sample;
+            sample.set_id(it);
+            sample.set_name(std::string(it % 7, '\n'));
+            for (int value = 0; value < it; ++value)
+                sample.get_timestamps().push_back(1700000000000 + value * 1000);
+
+            CompactFormat format;
+            sequential::to_format(format, sample);
+            sequential::framing::length_prefixed::append(stream, format.output());
+        }
+        return stream;
+    }
+}
+
+int main()
+{
+    const int count = 200;
+    const std::string stream = lengthPrefixedStream(count);
+
+    for (std::size_t chunkSize: { std::size_t(1), std::size_t(3), std::size_t(64), stream.size() })
+    {
+        int decoded = 0;
+        bool intact = true;
+        for (auto &sample: sequential::decode_stream<Sample, CompactFormat>(ChunkedSource{ &stream, chunkSize, 0 }))
+        {
+            intact = intact &&
+                     sample.get_id() == decoded &&
+                     sample.get_name() == std::string(decoded % 7, '\n') &&
+                     sample.get_timestamps().size() == std::size_t(decoded) &&
+                     (decoded == 0 || sample.get_timestamps().back() == 1700000000000 + (decoded - 1) * 1000);
+            ++decoded;
+        }
+        test::expect(intact, "length-prefixed records decode intact");
+        test::expect(decoded == count, "length-prefixed record count");
+    }
+
+    const std::string truncated = stream.substr(0, stream.size() - 1);
+    bool threw = false;
+    int decoded = 0;
+    try
+    {
+        for (auto &sample: sequential::decode_stream<Sample, CompactFormat>(ChunkedSource{ &truncated, 5, 0 }))
+        {
+            (void)sample;
+            ++decoded;
+        }
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    test::expect(threw, "truncated length-prefixed stream throws");
+    test::expect(decoded == count - 1, "records before the truncated one are still yielded");
+
+    std::string text;
+    sequential::framing::newline_delimited::append(text, "first");
+    text.append("\n\r\n");
+    sequential::framing::newline_delimited::append(text, "second\r");
+    text.append(std::string(100000, 'x'));
+
+    std::vector<std::string> lines;
+    for (auto &line: sequential::decode_stream<Line, LineFormat>(ChunkedSource{ &text, 7, 0 }))
+        lines.push_back(line.get_text());
+
+    test::expect(lines.size() == 3, "newline-delimited record count");
+    test::expect(lines.size() == 3 && lines[0] == "first" && lines[1] == "second" && lines[2].size() == 100000,
+           "newline-delimited records, blank lines skipped, unterminated last line kept");
+
+#ifdef SEQUENTIAL_TEST_JSON
+    std::string ndjson;
+    for (int it = 0; it < count; ++it)
+    {
+        Event event;
+        event.set_id(it);
+        event.set_name("event \"" + std::to_string(it) + "\"");
+        for (int value = 0; value < it % 5; ++value)
+            event.get_timestamps().push_back(1700000000000 + value);
+
+        JsonFormat format;
+        sequential::to_format(format, event);
+        sequential::framing::newline_delimited::append(ndjson, format.output().dump());
+    }
+
+    for (std::size_t chunkSize: { std::size_t(1), std::size_t(5), std::size_t(4096) })
+    {
+        int events = 0;
+        bool intact = true;
+        for (auto &event: sequential::decode_stream<Event, JsonFormat>(ChunkedSource{ &ndjson, chunkSize, 0 }))
+        {
+            intact = intact &&
+                     event.get_id() == events &&
+                     event.get_name() == "event \"" + std::to_string(events) + "\"" &&
+                     event.get_timestamps().size() == std::size_t(events % 5);
+            ++events;
+        }
+        test::expect(intact, "NDJSON records split across chunks decode intact");
+        test::expect(events == count, "NDJSON record count");
+    }
+#endif
+
+    auto generator = sequential::decode_stream<Sample, CompactFormat>(ChunkedSource{ &stream, 64, 0 });
+    auto moved = std::move(generator);
+    test::expect(generator.begin() == generator.end(), "a moved-from generator is empty");
+    test::expect(moved.begin() != moved.end(), "the moved-to generator still yields");
+
+    return test::finish("decode_stream_test");
+}
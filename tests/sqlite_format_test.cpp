@@ -0,0 +1,201 @@
+// Schema registry, migration and row binding checks for SQLiteFormat.
+
+#include <cstdio>
+#include <string>
+
+#include "../sequential.h"
+#include "../formats/sqlite_format.h"
+
+#include "test.h"
+
+namespace
+{
+    void execute(const std::string &path, const char *query)
+    {
+        sqlite3 *db = nullptr;
+        sqlite3_open(path.c_str(), &db);
+        sqlite3_exec(db, query, nullptr, nullptr, nullptr);
+        sqlite3_close(db);
+    }
+
+    int count(const std::string &path, const char *query)
+    {
+        sqlite3 *db = nullptr;
+        sqlite3_open(path.c_str(), &db);
+        sqlite3_stmt *statement = nullptr;
+        sqlite3_prepare_v2(db, query, -1, &statement, nullptr);
+        const int result = sqlite3_step(statement) == SQLITE_ROW ? sqlite3_column_int(statement, 0) : -1;
+        sqlite3_finalize(statement);
+        sqlite3_close(db);
+        return result;
+    }
+
+    struct Person
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, name)
+        INIT_ATTRIBUTES(id, name)
+    };
+
+    struct Scored
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE(double, score)
+        INIT_ATTRIBUTES(id, name, score)
+    };
+
+    struct Flagged
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE(double, score)
+        ATTRIBUTE(bool, ok)
+        INIT_ATTRIBUTES(id, name, score, ok)
+    };
+
+    struct Swapped
+    {
+        ATTRIBUTE(std::string, name)
+        ATTRIBUTE(int, id)
+        INIT_ATTRIBUTES(name, id)
+    };
+
+    struct Retyped
+    {
+        ATTRIBUTE(int, id)
+        ATTRIBUTE(int, name)
+        INIT_ATTRIBUTES(id, name)
+    };
+}
+
+int main()
+{
+    const std::string path = "sqlite_format_test.sqlite";
+    std::remove(path.c_str());
+    std::string error;
+
+    {
+        SQLiteFormat format(path, "people");
+        for (int it = 0; it < 3; ++it)
+        {
+            Person person;
+            person.set_id(it);
+            person.set_name("it's " + std::to_string(it));
+            sequential::to_format(format, person);
+            format.flush<Person>(&error);
+        }
+        test::expect(error.empty(), "typed flush");
+
+        Swapped swapped;
+        swapped.set_name("swapped");
+        swapped.set_id(3);
+        sequential::to_format(format, swapped);
+        format.flush(&error);
+        test::expect(error.empty(), "plain flush with columns in a different order");
+
+        sequential::to_format(format, swapped);
+        format.flush<Person>(&error);
+        test::expect(!error.empty(), "typed flush rejects a row of another Struct with the same arity");
+
+        Person person;
+        sequential::to_format(format, person);
+        error.clear();
+        format.flush<Scored>(&error);
+        test::expect(!error.empty(), "typed flush rejects a row of another Struct");
+    }
+
+    test::expect(count(path, "SELECT COUNT(*) FROM pragma_table_info('people') WHERE name = 'score';") == 0,
+                 "a rejected row does not migrate the table");
+
+    {
+        SQLiteFormat format(path, "people");
+        Scored scored;
+        scored.set_id(4);
+        scored.set_name("scored");
+        scored.set_score(2.5);
+        sequential::to_format(format, scored);
+        error.clear();
+        format.flush<Scored>(&error);
+        test::expect(error.empty(), "additive migration");
+    }
+
+    {
+        SQLiteFormat format(path, "people");
+        Retyped retyped;
+        sequential::to_format(format, retyped);
+        error.clear();
+        format.flush<Retyped>(&error);
+        test::expect(!error.empty(), "declared type mismatch is reported");
+    }
+
+    {
+        execute(path, "CREATE TABLE mismatched (id INTEGER, name TEXT);");
+
+        SQLiteFormat format(path, "mismatched");
+        Retyped retyped;
+        sequential::to_format(format, retyped);
+        error.clear();
+        format.flush<Retyped>(&error);
+        const std::string first = error;
+
+        execute(path, "DROP TABLE mismatched;");
+        sequential::to_format(format, retyped);
+        error.clear();
+        format.flush<Retyped>(&error);
+        test::expect(!first.empty() && error == first, "a failed schema check is reported again from cache");
+        test::expect(count(path, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'mismatched';") == 0,
+                     "a failed schema check is not retried for every row");
+    }
+
+    {
+        SQLiteFormat format(path, "people");
+        format.populate(&error);
+        test::expect(format.rowCount() == 5, "row count");
+
+        int ids = 0;
+        bool namesMatch = true;
+        while (format.rowCount() > 0)
+        {
+            Scored scored;
+            sequential::from_format(format, scored);
+            ids += scored.get_id();
+            const int id = scored.get_id();
+            const std::string expected = id < 3 ? "it's " + std::to_string(id) : id == 3 ? "swapped" : "scored";
+            namesMatch = namesMatch && scored.get_name() == expected;
+            format.removeFormatedRow();
+        }
+        test::expect(ids == 0 + 1 + 2 + 3 + 4, "ids bound to the id column");
+        test::expect(namesMatch, "names bound to the name column");
+    }
+
+    {
+        execute(path, "CREATE TABLE legacy (id INT PRIMARY KEY, name VARCHAR(64), score DOUBLE, ok BOOLEAN);");
+
+        SQLiteFormat format(path, "legacy");
+        for (int it = 0; it < 2; ++it)
+        {
+            Flagged flagged;
+            flagged.set_id(it);
+            flagged.set_name("legacy");
+            flagged.set_score(it + 0.5);
+            flagged.set_ok(it == 1);
+            sequential::to_format(format, flagged);
+            error.clear();
+            format.flush<Flagged>(&error);
+            test::expect(error.empty(), "typed flush into INT/VARCHAR/DOUBLE/BOOLEAN columns");
+
+            flagged.set_id(it + 10);
+            sequential::to_format(format, flagged);
+            error.clear();
+            format.flush(&error);
+            test::expect(error.empty(), "plain flush into INT/VARCHAR/DOUBLE/BOOLEAN columns");
+        }
+        test::expect(count(path, "SELECT COUNT(*) FROM legacy WHERE name = 'legacy';") == 4,
+                     "rows inserted into a hand-created table");
+    }
+
+    std::remove(path.c_str());
+
+    return test::finish("sqlite_format_test");
+}
@@ -0,0 +1,38 @@
+#ifndef SEQUENTIAL_TEST_H
+#define SEQUENTIAL_TEST_H
+
+#include <cstdio>
+
+namespace test
+{
+    inline int &failures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void expect(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures();
+        }
+    }
+
+    template<typename ValueType>
+    void expect(const ValueType &actual, const ValueType &expected, const char *what)
+    {
+        expect(bool(actual == expected), what);
+    }
+
+    inline int finish(const char *name)
+    {
+        if (failures() == 0)
+            std::printf("%s: all passed\n", name);
+
+        return failures() == 0 ? 0 : 1;
+    }
+}
+
+#endif // SEQUENTIAL_TEST_H